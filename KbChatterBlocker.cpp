@@ -1,20 +1,172 @@
 #include <windows.h>
-#include <unordered_map>
 #include <chrono>
 
 // Configuration
 const int CHATTER_THRESHOLD_MS = 15;         // Block everything faster than this
 const int REPEAT_TRANSITION_DELAY_MS = 150;  // Time to enter repeat mode
+const int MIN_INTENTIONAL_DWELL_MS = 10;     // Real presses are held at least this long
+const int SHORT_DWELL_THRESHOLD_MS = 40;     // Wider chatter window after a bounce-short release
+const int FLIGHT_THRESHOLD_MS = 5;           // Release-to-press gap treated as a bounce
+
+// How a press is judged against the previous one
+enum ChatterPolicy {
+    POLICY_PRESS_TO_PRESS,  // Interval between consecutive presses
+    POLICY_FLIGHT_TIME      // Gap between the last release and this press
+};
+const ChatterPolicy CHATTER_POLICY = POLICY_PRESS_TO_PRESS;
+
+// Key classes with their own chatter and repeat semantics
+enum KeyClass {
+    KEY_CLASS_STANDARD,
+    KEY_CLASS_MEDIA,        // Media, volume, browser, launch and sleep keys
+    KEY_CLASS_COUNT
+};
+
+struct KeyClassPolicy {
+    int chatterThresholdMs;  // 0 passes every press through
+    bool usesSystemRepeat;   // Repeats come from Windows, so repeat mode applies
+};
+
+const KeyClassPolicy KEY_CLASS_POLICIES[KEY_CLASS_COUNT] = {
+    { CHATTER_THRESHOLD_MS, true },  // Standard
+    { 0, false }                     // Media: often a separate interface with device-side repeat
+};
+
+constexpr KeyClass GetKeyClass(DWORD vkCode) {
+    return (vkCode >= VK_BROWSER_BACK && vkCode <= VK_LAUNCH_APP2) || vkCode == VK_SLEEP
+        ? KEY_CLASS_MEDIA
+        : KEY_CLASS_STANDARD;
+}
+
+// Correction feedback: how the user reacts right after a decision
+const int CORRECTION_WINDOW_MS = 1000;       // Re-press or Backspace within this counts as a correction
+const int SUSPECT_DOUBLE_WINDOW_MS = 100;    // Accepted same-key presses closer than this may be chatter
+const bool ADAPTIVE_THRESHOLDS = false;      // Nudge per-key chatter threshold from corrections
+const int MAX_THRESHOLD_ADJUST_MS = 10;      // Bound on the per-key nudge in either direction
+
+// Statistics published for external viewers
+const wchar_t* const STATS_SEGMENT_NAME = L"Local\\KbChatterBlockerStats";
+const unsigned int STATS_SEGMENT_VERSION = 1;
+const int STATS_WINDOW_COUNT = 3;
+const int STATS_BUCKET_COUNT = 12;           // Buckets per rolling window
+const int STATS_BUCKET_MS[STATS_WINDOW_COUNT] = {
+    5 * 1000,       // 1 minute window
+    25 * 1000,      // 5 minute window
+    5 * 60 * 1000   // 1 hour window
+};
+
+// Wireless and remote input can arrive as queued bursts with compressed timing
+const int BURST_INTERVAL_MS = 1;             // Events this close together belong to one delivery
+const int BURST_MIN_EVENTS = 3;              // Run length at which a delivery counts as a burst
+
+// Timing state older than a resume is treated as a first press
+const wchar_t* const POWER_WINDOW_CLASS = L"KbChatterBlockerPower";
 
 int REPEAT_THRESHOLD_MS = 0;  // Will be set from system settings on startup
 
-struct KeyState {
+const DWORD KEY_COUNT = 256;  // Virtual-key codes are 1-254
+
+// One cache line per key, so a decision never touches a neighbour's state
+struct alignas(64) KeyState {
     long long lastPressTime = 0;
+    long long lastReleaseTime = 0;
+    long long lastBlockTime = 0;
+    long long blockedFlightTime = 0;  // Release-to-press gap before the last blocked press, -1 if none
+    int thresholdAdjustMs = 0;
+    unsigned int epoch = 0;     // Timing fields are valid only while this matches stateEpoch
+    unsigned int lastReleaseSequence = 0;
     bool inRepeatMode = false;
 };
 
-std::unordered_map<DWORD, KeyState> keyStates;
+// One slice of a rolling window. A bucket whose epoch is not the current
+// time / STATS_BUCKET_MS belongs to an older slice and counts as empty.
+struct StatsBucket {
+    unsigned int epoch;
+    unsigned int presses;
+    unsigned int blocks;
+};
+
+// Counters, kept apart from the hot decision state
+struct KeyStats {
+    unsigned int presses;
+    unsigned int blocks;
+    unsigned int suspectedFalseBlocks;    // Blocked, then pressed again by the user
+    unsigned int suspectedMissedChatter;  // Accepted as a double, then Backspaced
+    StatsBucket windows[STATS_WINDOW_COUNT][STATS_BUCKET_COUNT];
+};
+
+// Totals per KeyClass, so media keys can be told apart at a glance
+struct KeyClassStats {
+    unsigned int presses;
+    unsigned int blocks;
+};
+
+// Layout of the shared memory section. Viewers check version and size first;
+// new fields are only appended. Times are std::chrono::steady_clock milliseconds
+// (QueryPerformanceCounter based on MSVC), so a viewer reads the same clock and
+// takes now / bucketMs as the current bucket epoch rather than trusting
+// lastUpdateTime, which stops moving while the keyboard is idle.
+struct StatsSegment {
+    unsigned int version;
+    unsigned int size;
+    unsigned int bucketMs[STATS_WINDOW_COUNT];
+    unsigned int bucketCount;
+    long long lastUpdateTime;
+    KeyStats keys[KEY_COUNT];
+    KeyClassStats classes[KEY_CLASS_COUNT];
+};
+
+// Internal event record, converted once from the hook's KBDLLHOOKSTRUCT.
+// Its timestamp travels next to it as full 64-bit steady clock milliseconds.
+enum KeyEventFlags {
+    KEY_EVENT_DOWN = 0x01,
+    KEY_EVENT_UP = 0x02
+};
+
+struct KeyEvent {
+    BYTE vkCode;
+    BYTE flags;       // KeyEventFlags
+    BYTE reserved[2];
+};
+static_assert(sizeof(KeyEvent) == 4, "KeyEvent must stay 4 bytes");
+
+KeyState keyStates[KEY_COUNT];
+unsigned int stateEpoch = 1;
+StatsSegment localStats;           // Used when the shared section is unavailable
+StatsSegment* stats = &localStats;
+HANDLE hStatsMapping = NULL;
+DWORD lastSuspectDoubleKey = 0;
+long long lastSuspectDoubleTime = 0;
+
+// Delivery pattern of the merged input stream; the hook cannot tell devices apart
+struct BurstState {
+    long long lastEventTime = 0;
+    int runLength = 0;          // Consecutive events within BURST_INTERVAL_MS
+    unsigned int sequence = 0;  // Index of the current event
+    DWORD lastDownVkCode = 0;   // Last key to go down, and when in sequence
+    unsigned int lastDownSequence = 0;
+};
+BurstState burst;
 HHOOK hHook = NULL;
+HWND hPowerWindow = NULL;
+
+// Bumping the epoch ages out every key at once; each entry is reset lazily
+// on its next event, so resume never walks the table
+void InvalidateKeyStates() {
+    stateEpoch++;
+    lastSuspectDoubleKey = 0;
+}
+
+KeyState& RefreshKeyState(DWORD vkCode) {
+    KeyState& state = keyStates[vkCode];
+    if (state.epoch != stateEpoch) {
+        int thresholdAdjustMs = state.thresholdAdjustMs;
+        state = KeyState();
+        state.thresholdAdjustMs = thresholdAdjustMs;
+        state.epoch = stateEpoch;
+    }
+    return state;
+}
 
 long long GetCurrentTimeMs() {
     return std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -44,11 +196,73 @@ void InitializeSystemKeyboardSettings() {
     }
 }
 
-bool ShouldBlockKey(DWORD vkCode) {
+void InitializeStatsSegment() {
+    hStatsMapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+        0, sizeof(StatsSegment), STATS_SEGMENT_NAME);
+    if (hStatsMapping != NULL) {
+        void* view = MapViewOfFile(hStatsMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(StatsSegment));
+        if (view != NULL) {
+            stats = (StatsSegment*)view;
+        }
+    }
+
+    // A viewer may have kept the section alive from an earlier run
+    ZeroMemory(stats, sizeof(StatsSegment));
+    stats->version = STATS_SEGMENT_VERSION;
+    stats->size = sizeof(StatsSegment);
+    for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+        stats->bucketMs[w] = STATS_BUCKET_MS[w];
+    }
+    stats->bucketCount = STATS_BUCKET_COUNT;
+}
+
+void ReleaseStatsSegment() {
+    if (stats != &localStats) {
+        UnmapViewOfFile(stats);
+        stats = &localStats;
+    }
+    if (hStatsMapping != NULL) {
+        CloseHandle(hStatsMapping);
+        hStatsMapping = NULL;
+    }
+}
+
+// Buckets are recycled lazily when a press lands in them, so idle keys cost nothing
+void RecordKeyStats(DWORD vkCode, bool blocked, long long currentTime) {
+    KeyStats& keyStats = stats->keys[vkCode];
+    keyStats.presses++;
+    if (blocked) {
+        keyStats.blocks++;
+    }
+
+    KeyClassStats& classStats = stats->classes[GetKeyClass(vkCode)];
+    classStats.presses++;
+    if (blocked) {
+        classStats.blocks++;
+    }
+
+    for (int w = 0; w < STATS_WINDOW_COUNT; w++) {
+        unsigned int epoch = (unsigned int)(currentTime / STATS_BUCKET_MS[w]);
+        StatsBucket& bucket = keyStats.windows[w][epoch % STATS_BUCKET_COUNT];
+        if (bucket.epoch != epoch) {
+            bucket.epoch = epoch;
+            bucket.presses = 0;
+            bucket.blocks = 0;
+        }
+        bucket.presses++;
+        if (blocked) {
+            bucket.blocks++;
+        }
+    }
+
+    stats->lastUpdateTime = currentTime;
+}
+
+bool ShouldBlockKey(DWORD vkCode, long long currentTime) {
     KeyState& state = keyStates[vkCode];
-    long long currentTime = GetCurrentTimeMs();
+    const KeyClassPolicy& policy = KEY_CLASS_POLICIES[GetKeyClass(vkCode)];
 
-    if (state.lastPressTime == 0) {
+    if (state.lastPressTime == 0 || policy.chatterThresholdMs == 0) {
         state.lastPressTime = currentTime;
         return false;
     }
@@ -56,12 +270,34 @@ bool ShouldBlockKey(DWORD vkCode) {
     long long timeSincePress = currentTime - state.lastPressTime;
 
     // Check if we should enter repeat mode
-    if (timeSincePress > REPEAT_TRANSITION_DELAY_MS) {
+    if (policy.usesSystemRepeat && timeSincePress > REPEAT_TRANSITION_DELAY_MS) {
         state.inRepeatMode = true;
     }
 
+    bool releasedSincePress = state.lastReleaseTime >= state.lastPressTime;
+
+    // Flight time excludes the hold time, so a much smaller threshold is enough
+    // and fast double letters pass. Held keys have no release to measure from
+    // and fall back to the press-to-press rule below.
+    if (CHATTER_POLICY == POLICY_FLIGHT_TIME && releasedSincePress) {
+        long long flightTime = currentTime - state.lastReleaseTime;
+        if (flightTime < FLIGHT_THRESHOLD_MS) {
+            return true;
+        }
+
+        state.lastPressTime = currentTime;
+        return false;
+    }
+
     // Use different threshold for repeat mode
-    int threshold = state.inRepeatMode ? REPEAT_THRESHOLD_MS : CHATTER_THRESHOLD_MS;
+    int threshold = state.inRepeatMode ? REPEAT_THRESHOLD_MS : policy.chatterThresholdMs + state.thresholdAdjustMs;
+
+    // A release that came almost immediately after the last press is itself a
+    // bounce, so the press following it is very likely chatter as well
+    long long dwellTime = state.lastReleaseTime - state.lastPressTime;
+    if (!state.inRepeatMode && releasedSincePress && dwellTime < MIN_INTENTIONAL_DWELL_MS) {
+        threshold = SHORT_DWELL_THRESHOLD_MS;
+    }
 
     // Block if faster than threshold
     if (timeSincePress < threshold) {
@@ -72,27 +308,168 @@ bool ShouldBlockKey(DWORD vkCode) {
     return false;
 }
 
+void AdjustThreshold(KeyState& state, int deltaMs) {
+    if (!ADAPTIVE_THRESHOLDS) {
+        return;
+    }
+
+    int adjust = state.thresholdAdjustMs + deltaMs;
+    if (adjust > MAX_THRESHOLD_ADJUST_MS) {
+        adjust = MAX_THRESHOLD_ADJUST_MS;
+    } else if (adjust < -MAX_THRESHOLD_ADJUST_MS) {
+        adjust = -MAX_THRESHOLD_ADJUST_MS;
+    }
+    state.thresholdAdjustMs = adjust;
+}
+
+void TrackCorrections(DWORD vkCode, bool blocked, long long previousPressTime, long long currentTime) {
+    KeyState& state = keyStates[vkCode];
+
+    if (blocked) {
+        state.lastBlockTime = currentTime;
+        bool releasedSincePress = state.lastReleaseTime >= previousPressTime;
+        state.blockedFlightTime = releasedSincePress ? currentTime - state.lastReleaseTime : -1;
+        return;
+    }
+
+    // Releasing and pressing a key again soon after we ate a press suggests the
+    // block was wrong. Requiring the release also rules out auto-repeat of a
+    // key that is still held. A bounce follows its release by a millisecond or
+    // two, so only a blocked press with a human-sized gap before it is suspect;
+    // otherwise this would just count how often the key chatters.
+    bool releasedSinceBlock = state.lastReleaseTime > state.lastBlockTime;
+    bool blockLookedIntentional = state.blockedFlightTime >= FLIGHT_THRESHOLD_MS;
+    if (state.lastBlockTime != 0 && releasedSinceBlock && blockLookedIntentional &&
+        currentTime - state.lastBlockTime < CORRECTION_WINDOW_MS) {
+        stats->keys[vkCode].suspectedFalseBlocks++;
+        AdjustThreshold(state, -1);
+    }
+    state.lastBlockTime = 0;
+
+    // Backspace right after a fast double letter suggests the double was chatter
+    if (vkCode == VK_BACK) {
+        if (lastSuspectDoubleKey != 0 && currentTime - lastSuspectDoubleTime < CORRECTION_WINDOW_MS) {
+            stats->keys[lastSuspectDoubleKey].suspectedMissedChatter++;
+            AdjustThreshold(keyStates[lastSuspectDoubleKey], 1);
+        }
+        lastSuspectDoubleKey = 0;
+        return;
+    }
+
+    // Only the most recent key can be the one a Backspace corrects
+    bool isSuspectDouble = previousPressTime != 0 && !state.inRepeatMode &&
+        currentTime - previousPressTime < SUSPECT_DOUBLE_WINDOW_MS;
+    lastSuspectDoubleKey = isSuspectDouble ? vkCode : 0;
+    lastSuspectDoubleTime = currentTime;
+}
+
+void UpdateBurstState(long long currentTime) {
+    if (burst.lastEventTime != 0 && currentTime - burst.lastEventTime <= BURST_INTERVAL_MS) {
+        burst.runLength++;
+    } else {
+        burst.runLength = 1;
+    }
+    burst.lastEventTime = currentTime;
+    burst.sequence++;
+}
+
+// Inside a burst the timestamps say nothing, so decide by order instead: bounce
+// never interleaves other keys, while queued typing does. Releases say nothing
+// about queuing (rollover lifts the previous key right around a bounce), so only
+// another key going down after this key's last release lets a press through.
+bool IsReorderedBurstPress(DWORD vkCode, const KeyState& state) {
+    return burst.runLength >= BURST_MIN_EVENTS &&
+        state.lastPressTime != 0 &&
+        burst.lastDownVkCode != vkCode &&
+        (int)(burst.lastDownSequence - state.lastReleaseSequence) > 0;
+}
+
+bool ProcessKeyEvent(const KeyEvent& event, long long currentTime) {
+    DWORD vkCode = event.vkCode;
+    KeyState& state = RefreshKeyState(vkCode);
+    UpdateBurstState(currentTime);
+
+    // Reset repeat mode and remember release time for dwell tracking
+    if (event.flags & KEY_EVENT_UP) {
+        state.inRepeatMode = false;
+        state.lastReleaseTime = currentTime;
+        state.lastReleaseSequence = burst.sequence;
+        return false;
+    }
+
+    if (event.flags & KEY_EVENT_DOWN) {
+        long long previousPressTime = state.lastPressTime;
+        bool blocked = false;
+        if (IsReorderedBurstPress(vkCode, state)) {
+            state.lastPressTime = currentTime;
+        } else {
+            blocked = ShouldBlockKey(vkCode, currentTime);
+        }
+        burst.lastDownVkCode = vkCode;
+        burst.lastDownSequence = burst.sequence;
+
+        TrackCorrections(vkCode, blocked, previousPressTime, currentTime);
+        RecordKeyStats(vkCode, blocked, currentTime);
+        return blocked;
+    }
+
+    return false;
+}
+
 LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
     if (nCode == HC_ACTION) {
         KBDLLHOOKSTRUCT* pKbdStruct = (KBDLLHOOKSTRUCT*)lParam;
-        DWORD vkCode = pKbdStruct->vkCode;
-
-        bool isKeyDown = (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN);
-        bool isKeyUp = (wParam == WM_KEYUP || wParam == WM_SYSKEYUP);
-        
-        // Reset repeat mode on key release
-        if (isKeyUp) {
-            keyStates[vkCode].inRepeatMode = false;
-        }
-        
-        if (isKeyDown && ShouldBlockKey(vkCode)) {
-            return 1; // Block the key
+
+        if (pKbdStruct->vkCode < KEY_COUNT) {
+            // pKbdStruct->time follows the system timer (often ~15.6 ms steps),
+            // too coarse for the chatter thresholds
+            long long currentTime = GetCurrentTimeMs();
+
+            KeyEvent event = {};
+            event.vkCode = (BYTE)pKbdStruct->vkCode;
+            if (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN) {
+                event.flags |= KEY_EVENT_DOWN;
+            } else if (wParam == WM_KEYUP || wParam == WM_SYSKEYUP) {
+                event.flags |= KEY_EVENT_UP;
+            }
+
+            if (ProcessKeyEvent(event, currentTime)) {
+                return 1; // Block the key
+            }
         }
     }
 
     return CallNextHookEx(hHook, nCode, wParam, lParam);
 }
 
+LRESULT CALLBACK PowerWindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam) {
+    if (message == WM_POWERBROADCAST &&
+        (wParam == PBT_APMRESUMEAUTOMATIC || wParam == PBT_APMRESUMESUSPEND)) {
+        InvalidateKeyStates();
+    }
+
+    // A plain taskkill closes this window; end the message loop so the process
+    // exits through the normal cleanup instead of running on without it
+    if (message == WM_DESTROY) {
+        hPowerWindow = NULL;
+        PostQuitMessage(0);
+        return 0;
+    }
+
+    return DefWindowProc(hWnd, message, wParam, lParam);
+}
+
+HWND CreatePowerWindow(HINSTANCE hInstance) {
+    // Hidden top-level window; message-only windows miss power broadcasts
+    WNDCLASS wc = {};
+    wc.lpfnWndProc = PowerWindowProc;
+    wc.hInstance = hInstance;
+    wc.lpszClassName = POWER_WINDOW_CLASS;
+    RegisterClass(&wc);
+
+    return CreateWindowEx(0, POWER_WINDOW_CLASS, L"", 0, 0, 0, 0, 0, NULL, NULL, hInstance, NULL);
+}
+
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
     // Initialize keyboard settings from system
     InitializeSystemKeyboardSettings();
@@ -104,10 +481,20 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         return 0;
     }
 
+    // Publish statistics only once we know we are the single instance
+    InitializeStatsSegment();
+
+    // Power notifications are best effort; the hook runs without them
+    hPowerWindow = CreatePowerWindow(hInstance);
+
     // Install keyboard hook
     hHook = SetWindowsHookEx(WH_KEYBOARD_LL, LowLevelKeyboardProc, NULL, 0);
     
     if (hHook == NULL) {
+        if (hPowerWindow != NULL) {
+            DestroyWindow(hPowerWindow);
+        }
+        ReleaseStatsSegment();
         ReleaseMutex(hMutex);
         CloseHandle(hMutex);
         return 1;
@@ -122,6 +509,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
     // Cleanup
     UnhookWindowsHookEx(hHook);
+    if (hPowerWindow != NULL) {
+        DestroyWindow(hPowerWindow);
+    }
+    ReleaseStatsSegment();
     ReleaseMutex(hMutex);
     CloseHandle(hMutex);
 